@@ -0,0 +1,392 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+/*
+ * Thread and memory placement for NUMA (multi-socket) machines.
+ *
+ * Environment variables:
+ *    PLACE_BIND=none|compact|spread
+ *       How thread ids are mapped to cpus. Default: none (nothing is pinned
+ *       and the OS places threads and pages like before).
+ *       compact  fills the cpus of node 0, then the cpus of node 1, ...
+ *       spread   alternates between the nodes: id 0 on node 0, id 1 on
+ *                node 1, ...
+ *    PLACE_CPUS=<list>
+ *       Explicit cpu for each thread id, e.g. 0-7,16-23. Overrides PLACE_BIND.
+ *    PLACE_HUGEPAGES=1
+ *       Buffers of at least 2MB returned by allocate are backed by
+ *       transparent huge pages.
+ *
+ * Thread id i is bound to the i-th cpu of the order, wrapping around when
+ * there are more ids than cpus. Linux puts a page on the node of the
+ * thread that touches it first, so firstTouch has thread id initialize
+ * chunk id ([(n * id) / numThreads, (n * (id + 1)) / numThreads)), which
+ * is the chunk that thread id works on later. distribute moves the pages
+ * of memory that has already been touched (e.g. the buffer of a
+ * std::vector) to the nodes that will use them.
+ *
+ * The nodes are read from /sys/devices/system/node, so libnuma isn't needed.
+ * On a machine with one node everything still works; binding just pins
+ * threads to cores.
+ *
+ * Nodes are numbered 0, 1, ... in the order of their Linux node ids, and
+ * only the nodes with cpus this process can use are included, so node i
+ * isn't Linux node i if the process is restricted (e.g., with numactl
+ * --cpunodebind=1,2) or the machine has memory-only nodes. Node::id is the
+ * Linux node id that the system calls need.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace place
+{
+  const uint64_t HUGEPAGESIZE = 2 * 1024 * 1024;
+
+  struct Node
+  {
+    int id;                    //Linux node id
+    std::vector<int> cpus;     //usable cpus of the node
+  };
+
+  struct Topology
+  {
+    std::vector<Node> nodes;        //nodes with usable cpus
+    std::vector<int> nodeOfCpu;     //index in nodes; -1 for cpus that can't be used
+    std::vector<int> order;         //cpu of each thread id; empty if not binding
+  };
+
+  /*
+   * parseCpuList
+   * Parses a list in the format of /sys/devices/system/node/node0/cpulist
+   * (e.g., 0-3,8,10-11) and returns the cpus in it.
+   */
+  inline std::vector<int> parseCpuList(const std::string & list)
+  {
+    std::vector<int> cpus;
+    const char * p = list.c_str();
+    while (*p)
+    {
+      char * end;
+      long first = strtol(p, &end, 10);
+      if (end == p) break;
+      long last = first;
+      p = end;
+      if (*p == '-')
+      {
+        last = strtol(p + 1, &end, 10);
+        p = end;
+      }
+      for (long cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+      while (*p == ',' || *p == '\n' || *p == ' ') p++;
+    }
+    return cpus;
+  }
+
+  /*
+   * readCpuList
+   * Reads a cpu list from a sysfs file. Returns an empty list if the file
+   * can't be read.
+   */
+  inline std::vector<int> readCpuList(const std::string & path)
+  {
+    char buf[4096] = "";
+    FILE * fp = fopen(path.c_str(), "r");
+    if (fp == NULL) return std::vector<int>();
+    if (fgets(buf, sizeof(buf), fp) == NULL) buf[0] = '\0';
+    fclose(fp);
+    return parseCpuList(buf);
+  }
+
+  /*
+   * buildTopology
+   * Finds the cpus of each node that this process is allowed to run on
+   * (mpirun or taskset may have restricted them) and the cpu order chosen
+   * by PLACE_BIND or PLACE_CPUS.
+   */
+  inline Topology buildTopology()
+  {
+    Topology topo;
+    std::vector<Node> all;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &allowed);
+
+    DIR * dir = opendir("/sys/devices/system/node");
+    if (dir != NULL)
+    {
+      struct dirent * entry;
+      while ((entry = readdir(dir)) != NULL)
+      {
+        int id;
+        if (sscanf(entry->d_name, "node%d", &id) != 1) continue;
+        all.push_back(Node{id, readCpuList(std::string("/sys/devices/system/node/")
+                                           + entry->d_name + "/cpulist")});
+      }
+      closedir(dir);
+    }
+    if (all.empty())
+    {
+      all.push_back(Node{0, readCpuList("/sys/devices/system/cpu/online")});
+      if (all[0].cpus.empty())
+        for (int cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN); cpu++)
+          all[0].cpus.push_back(cpu);
+    }
+    //readdir doesn't return the nodes in order
+    std::sort(all.begin(), all.end(),
+              [] (const Node & a, const Node & b) { return a.id < b.id; });
+
+    //drop the cpus this process can't use and the nodes without cpus
+    std::vector<Node> & nodes = topo.nodes;
+    for (auto & node : all)
+    {
+      std::vector<int> usable;
+      for (int cpu : node.cpus)
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) usable.push_back(cpu);
+      if (!usable.empty()) nodes.push_back(Node{node.id, usable});
+    }
+    for (uint64_t node = 0; node < nodes.size(); node++)
+    {
+      for (int cpu : nodes[node].cpus)
+      {
+        if (cpu >= (int) topo.nodeOfCpu.size()) topo.nodeOfCpu.resize(cpu + 1, -1);
+        topo.nodeOfCpu[cpu] = node;
+      }
+    }
+
+    const char * cpuList = getenv("PLACE_CPUS");
+    const char * bind = getenv("PLACE_BIND");
+    if (cpuList != NULL)
+    {
+      for (int cpu : parseCpuList(cpuList))
+        if (cpu < (int) topo.nodeOfCpu.size() && topo.nodeOfCpu[cpu] >= 0)
+          topo.order.push_back(cpu);
+    }
+    else if (bind != NULL && strcmp(bind, "compact") == 0)
+    {
+      for (auto & node : nodes)
+        topo.order.insert(topo.order.end(), node.cpus.begin(), node.cpus.end());
+    }
+    else if (bind != NULL && strcmp(bind, "spread") == 0)
+    {
+      for (uint64_t i = 0; ; i++)
+      {
+        bool added = false;
+        for (auto & node : nodes)
+        {
+          if (i < node.cpus.size())
+          {
+            topo.order.push_back(node.cpus[i]);
+            added = true;
+          }
+        }
+        if (!added) break;
+      }
+    }
+    else if (bind != NULL && strcmp(bind, "none") != 0)
+    {
+      fprintf(stderr, "PLACE_BIND must be none, compact or spread; not binding\n");
+    }
+    return topo;
+  }
+
+  inline const Topology & topology()
+  {
+    static Topology topo = buildTopology();
+    return topo;
+  }
+
+  inline int numNodes()
+  {
+    return topology().nodes.size();
+  }
+
+  inline bool binding()
+  {
+    return !topology().order.empty();
+  }
+
+  /*
+   * cpuFor
+   * Returns the cpu of thread id or -1 if threads aren't bound.
+   */
+  inline int cpuFor(uint64_t id)
+  {
+    const Topology & topo = topology();
+    if (topo.order.empty()) return -1;
+    return topo.order[id % topo.order.size()];
+  }
+
+  /*
+   * nodeFor
+   * Returns the node (index in topology().nodes) of thread id or -1 if
+   * threads aren't bound.
+   */
+  inline int nodeFor(uint64_t id)
+  {
+    int cpu = cpuFor(id);
+    return (cpu < 0) ? -1 : topology().nodeOfCpu[cpu];
+  }
+
+  /*
+   * bindThread
+   * Pins the calling thread to the cpu of thread id.
+   * Returns false if threads aren't bound or the call failed.
+   */
+  inline bool bindThread(uint64_t id)
+  {
+    int cpu = cpuFor(id);
+    if (cpu < 0) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+  }
+
+  /*
+   * bindToNode
+   * Lets the calling thread run on any cpu of node (index in
+   * topology().nodes), regardless of PLACE_BIND. Returns false if the call
+   * failed.
+   */
+  inline bool bindToNode(int node)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : topology().nodes[node].cpus) CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+  }
+
+#ifdef _OPENMP
+  /*
+   * bindOmpTeam
+   * Called by every thread at the start of a parallel region; pins each
+   * thread of the team to the cpu of its thread number.
+   */
+  inline void bindOmpTeam()
+  {
+    bindThread(omp_get_thread_num());
+  }
+#endif
+
+  inline bool hugePages()
+  {
+    const char * env = getenv("PLACE_HUGEPAGES");
+    return env != NULL && strcmp(env, "1") == 0;
+  }
+
+  /*
+   * allocate
+   * Allocates space for n values of type T with mmap. None of the pages
+   * are touched, so they are placed by whichever threads initialize them.
+   * The buffer is aligned to at least a page and, with PLACE_HUGEPAGES=1, to
+   * a huge page. Must be freed with release. Throws std::bad_alloc on failure.
+   */
+  template <typename T>
+  T * allocate(uint64_t n)
+  {
+    uint64_t bytes = std::max(n * sizeof(T), (uint64_t) 1);
+    bool huge = hugePages() && bytes >= HUGEPAGESIZE;
+    uint64_t mapped = huge ? bytes + HUGEPAGESIZE : bytes;
+    void * raw = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) throw std::bad_alloc();
+    if (!huge) return (T *) raw;
+
+    //trim the mapping so the buffer starts on a huge page boundary
+    uint64_t pageSize = sysconf(_SC_PAGESIZE);
+    char * start = (char *) raw;
+    char * aligned = (char *) (((uintptr_t) start + HUGEPAGESIZE - 1) & ~(HUGEPAGESIZE - 1));
+    char * end = aligned + ((bytes + pageSize - 1) / pageSize) * pageSize;
+    if (aligned > start) munmap(start, aligned - start);
+    if (start + mapped > end) munmap(end, start + mapped - end);
+    madvise(aligned, bytes, MADV_HUGEPAGE);  //ignored if THP is disabled
+    return (T *) aligned;
+  }
+
+  /*
+   * release
+   * Frees a buffer of n values returned by allocate.
+   */
+  template <typename T>
+  void release(T * p, uint64_t n)
+  {
+    if (p != NULL) munmap((void *) p, std::max(n * sizeof(T), (uint64_t) 1));
+  }
+
+  /*
+   * firstTouch
+   * Splits [0, n) into numThreads contiguous chunks and calls
+   * init(begin, end) for chunk id on a new thread bound with bindThread(id),
+   * so the pages initialized by init end up on the node of thread id.
+   * Returns after all chunks are initialized.
+   */
+  template <typename Func>
+  void firstTouch(uint64_t n, uint64_t numThreads, Func init)
+  {
+    std::vector<std::thread> threads;
+    for (uint64_t id = 0; id < numThreads; id++)
+    {
+      threads.emplace_back([=] ( )
+      {
+        bindThread(id);
+        init((n * id) / numThreads, (n * (id + 1)) / numThreads);
+      });
+    }
+    for (auto & thread : threads) thread.join();
+  }
+
+  /*
+   * distribute
+   * Moves the pages of chunk id of the n values at p (split as in
+   * firstTouch into numChunks chunks) to the node of thread
+   * id % numThreads; numThreads of 0 means numChunks. Used for memory that
+   * was already touched by one thread. Does nothing if threads aren't bound
+   * or there is only one node. move_pages takes Linux node ids, not indexes
+   * in topology().nodes.
+   */
+  template <typename T>
+  void distribute(T * p, uint64_t n, uint64_t numChunks, uint64_t numThreads = 0)
+  {
+    if (numThreads == 0) numThreads = numChunks;
+    if (!binding() || numNodes() < 2 || n == 0) return;
+    const std::vector<Node> & topoNodes = topology().nodes;
+    uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    std::vector<void *> pages;
+    std::vector<int> nodes;
+    uintptr_t page = (uintptr_t) p & ~(pageSize - 1);
+    for (uint64_t id = 0; id < numChunks; id++)
+    {
+      //a page shared by two chunks goes with the first one
+      uintptr_t end = (uintptr_t) (p + (n * (id + 1)) / numChunks);
+      for (; page < end; page += pageSize)
+      {
+        pages.push_back((void *) page);
+        nodes.push_back(topoNodes[nodeFor(id % numThreads)].id);
+      }
+    }
+    std::vector<int> status(pages.size());
+    syscall(SYS_move_pages, 0, pages.size(), pages.data(), nodes.data(),
+            status.data(), MPOL_MF_MOVE);
+  }
+}
+
+#endif
@@ -0,0 +1,447 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/*
+ * Shared instrumentation for the assignments.
+ *
+ * Always available:
+ *    PROF_TIMERSTART(label) / PROF_TIMERSTOP(label) / PROF_GETTIME(label)
+ *       steady_clock (monotonic) timer used by the TIMERSTART, TIMERSTOP and
+ *       GETTIME macros in each directory's helpers.h. GETTIME is in seconds.
+ *
+ * Only when compiled with -DPROFILE (otherwise they expand to nothing):
+ *    PROF_SCOPE(label)      times the enclosing scope with steady_clock
+ *    PROF_SCOPE_TSC(label)  times the enclosing scope with rdtsc
+ *    PROF_SCOPE_HW(label)   PROF_SCOPE plus cycles, LLC misses and branch
+ *                           misses from perf_event_open (if PROF_COUNTERS=1
+ *                           is set in the environment and the kernel allows it)
+ *    label must be a string literal. Scopes can nest.
+ *
+ * Every thread records its events in its own buffer, so recording an
+ * event doesn't take a lock. The buffer is a list of fixed size chunks, so
+ * recording an event never copies the events recorded before it. Each
+ * event takes 64 bytes; don't put a scope in code that runs millions of
+ * times (e.g., every call of a recursive sort). When the program exits a summary table is
+ * printed to stderr (unless PROF_SUMMARY=0) and, if PROF_TRACE is set, the
+ * events are written to that file in Chrome trace JSON format (load it at
+ * chrome://tracing or ui.perfetto.dev). A %p in PROF_TRACE is replaced by
+ * the process id so MPI processes write separate files.
+ *
+ * Everything is in this header so the makefiles only need -I../profiler
+ * (or an include of "../profiler/profiler.h") and -DPROFILE to turn it on.
+ */
+
+#include <chrono>
+
+#define PROF_TIMERSTART(label)                                             \
+    std::chrono::steady_clock::time_point a##label, b##label;              \
+    a##label = std::chrono::steady_clock::now();
+
+#define PROF_TIMERSTOP(label)                                              \
+    b##label = std::chrono::steady_clock::now();                           \
+    std::chrono::duration<double> delta##label = b##label-a##label;        \
+    PROF_RECORD(#label, a##label, b##label);
+
+#define PROF_GETTIME(label) delta##label.count()
+
+#ifndef PROFILE
+
+#define PROF_RECORD(name, start, stop)
+#define PROF_SCOPE(label)
+#define PROF_SCOPE_TSC(label)
+#define PROF_SCOPE_HW(label)
+
+#else
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <x86intrin.h>
+
+#define PROF_CAT2(a, b) a##b
+#define PROF_CAT(a, b) PROF_CAT2(a, b)
+#define PROF_RECORD(name, start, stop) prof::record(name, start, stop)
+#define PROF_SCOPE(label) \
+    prof::ScopedTimer PROF_CAT(profScope, __LINE__)(label, prof::STEADY, false)
+#define PROF_SCOPE_TSC(label) \
+    prof::ScopedTimer PROF_CAT(profScope, __LINE__)(label, prof::TSC, false)
+#define PROF_SCOPE_HW(label) \
+    prof::ScopedTimer PROF_CAT(profScope, __LINE__)(label, prof::STEADY, true)
+
+namespace prof
+{
+  enum Clock { STEADY, TSC };
+  enum { CYCLES, LLC_MISSES, BRANCH_MISSES, NUMCOUNTERS };
+
+  struct Event
+  {
+    const char * label;
+    uint64_t start;        //nanoseconds (STEADY) or ticks (TSC)
+    uint64_t stop;
+    uint32_t depth;        //number of enclosing scopes on this thread
+    Clock clock;
+    bool hasCounters;
+    uint64_t counters[NUMCOUNTERS];
+  };
+
+  /*
+   * EventLog
+   * Events stored in chunks of CHUNKSIZE. When a chunk is full a new one is
+   * allocated; the full chunks are never moved, so adding an event costs
+   * the same no matter how many events were added before it.
+   */
+  class EventLog
+  {
+    private:
+      static const size_t CHUNKSIZE = 4096;
+      std::vector<std::unique_ptr<Event[]>> chunks;
+      size_t count;
+
+    public:
+      EventLog() : count(0)
+      {
+        chunks.emplace_back(new Event[CHUNKSIZE]);
+      }
+
+      void push(const Event & e)
+      {
+        if (count == chunks.size() * CHUNKSIZE) chunks.emplace_back(new Event[CHUNKSIZE]);
+        chunks[count / CHUNKSIZE][count % CHUNKSIZE] = e;
+        count++;
+      }
+
+      /*
+       * forEach
+       * Calls f on every event in the order they were added.
+       */
+      template <typename F>
+      void forEach(F f) const
+      {
+        for (size_t i = 0; i < count; i++) f(chunks[i / CHUNKSIZE][i % CHUNKSIZE]);
+      }
+  };
+
+  /*
+   * ThreadBuffer
+   * Events recorded by one thread and the perf_event file descriptors of
+   * that thread. Only the owning thread touches it until the program exits.
+   */
+  struct ThreadBuffer
+  {
+    uint32_t tid;
+    uint32_t depth;
+    int leaderFd;
+    bool countersOpened;
+    EventLog events;
+
+    ThreadBuffer(uint32_t tid_) : tid(tid_), depth(0), leaderFd(-1), countersOpened(false)
+    {
+    }
+
+    ~ThreadBuffer()
+    {
+      for (int fd : fds) close(fd);
+    }
+
+    /*
+     * openCounters
+     * Opens a group of cycles, LLC misses and branch misses counters for
+     * the calling thread. If perf_event_open fails (e.g., because of
+     * /proc/sys/kernel/perf_event_paranoid) the counters stay off.
+     */
+    void openCounters()
+    {
+      countersOpened = true;
+      const char * env = getenv("PROF_COUNTERS");
+      if (env == NULL || strcmp(env, "1") != 0) return;
+
+      uint64_t configs[NUMCOUNTERS] = {PERF_COUNT_HW_CPU_CYCLES,
+                                       PERF_COUNT_HW_CACHE_MISSES,
+                                       PERF_COUNT_HW_BRANCH_MISSES};
+      for (int i = 0; i < NUMCOUNTERS; i++)
+      {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leaderFd, 0);
+        if (fd < 0)
+        {
+          for (int open : fds) close(open);
+          fds.clear();
+          leaderFd = -1;
+          return;
+        }
+        if (i == 0) leaderFd = fd;
+        fds.push_back(fd);
+      }
+      ioctl(leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    /*
+     * readCounters
+     * Reads the counter group. Returns false if the counters are off.
+     */
+    bool readCounters(uint64_t * values)
+    {
+      if (!countersOpened) openCounters();
+      if (leaderFd < 0) return false;
+      uint64_t buf[1 + NUMCOUNTERS];
+      if (read(leaderFd, buf, sizeof(buf)) != (ssize_t) sizeof(buf)) return false;
+      memcpy(values, buf + 1, sizeof(uint64_t) * NUMCOUNTERS);
+      return true;
+    }
+
+    private:
+      std::vector<int> fds;
+  };
+
+  /*
+   * Registry
+   * Owns the buffers of all threads. A thread takes the lock only once, to
+   * register its buffer. The destructor runs when the program exits and
+   * produces the summary and the trace.
+   */
+  class Registry
+  {
+    private:
+      std::mutex mutex;
+      std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+      std::chrono::steady_clock::time_point steadyBase;
+      uint64_t tscBase;
+
+      //ticks per nanosecond, from the ticks and nanoseconds since construction
+      double tscRate()
+      {
+        uint64_t ticks = __rdtsc() - tscBase;
+        double ns = std::chrono::duration<double, std::nano>(
+                      std::chrono::steady_clock::now() - steadyBase).count();
+        return (ns > 0) ? ticks / ns : 1.0;
+      }
+
+      //converts an event time to microseconds since construction
+      double toMicroseconds(const Event & e, uint64_t t, double rate)
+      {
+        if (e.clock == TSC) return ((double) t - (double) tscBase) / rate / 1000.0;
+        uint64_t base = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          steadyBase.time_since_epoch()).count();
+        return ((double) t - (double) base) / 1000.0;
+      }
+
+    public:
+      Registry()
+      {
+        steadyBase = std::chrono::steady_clock::now();
+        tscBase = __rdtsc();
+      }
+
+      ~Registry()
+      {
+        const char * summary = getenv("PROF_SUMMARY");
+        if (summary == NULL || strcmp(summary, "0") != 0) printSummary(stderr);
+        const char * trace = getenv("PROF_TRACE");
+        if (trace != NULL) writeChromeTrace(trace);
+      }
+
+      ThreadBuffer * add()
+      {
+        std::lock_guard<std::mutex> lockGuard(mutex);
+        buffers.emplace_back(new ThreadBuffer(buffers.size()));
+        return buffers.back().get();
+      }
+
+      /*
+       * printSummary
+       * Prints one row per label: number of calls, total, mean, min and
+       * max time, and the counter totals if any were recorded.
+       */
+      void printSummary(FILE * fp)
+      {
+        struct Row
+        {
+          uint64_t calls = 0;
+          double total = 0, min = 1e300, max = 0;
+          uint64_t counters[NUMCOUNTERS] = {0, 0, 0};
+          bool hasCounters = false;
+        };
+        std::map<std::string, Row> rows;
+        double rate = tscRate();
+
+        std::lock_guard<std::mutex> lockGuard(mutex);
+        for (auto & buffer : buffers)
+        {
+          buffer->events.forEach([&] (const Event & e)
+          {
+            Row & row = rows[e.label];
+            double us = toMicroseconds(e, e.stop, rate) - toMicroseconds(e, e.start, rate);
+            row.calls++;
+            row.total += us;
+            row.min = std::min(row.min, us);
+            row.max = std::max(row.max, us);
+            if (e.hasCounters)
+            {
+              row.hasCounters = true;
+              for (int i = 0; i < NUMCOUNTERS; i++) row.counters[i] += e.counters[i];
+            }
+          });
+        }
+        if (rows.empty()) return;
+
+        fprintf(fp, "\n%-28s %10s %14s %12s %12s %12s %14s %12s %12s\n", "label", "calls",
+                "total (ms)", "mean (us)", "min (us)", "max (us)", "cycles", "LLC miss",
+                "br miss");
+        for (auto & r : rows)
+        {
+          const Row & row = r.second;
+          fprintf(fp, "%-28s %10lu %14.3f %12.3f %12.3f %12.3f", r.first.c_str(), row.calls,
+                  row.total / 1000.0, row.total / row.calls, row.min, row.max);
+          if (row.hasCounters)
+            fprintf(fp, " %14lu %12lu %12lu\n", row.counters[CYCLES],
+                    row.counters[LLC_MISSES], row.counters[BRANCH_MISSES]);
+          else
+            fprintf(fp, " %14s %12s %12s\n", "-", "-", "-");
+        }
+      }
+
+      /*
+       * writeChromeTrace
+       * Writes the events as complete ("X") events in Chrome trace JSON.
+       */
+      void writeChromeTrace(const char * pattern)
+      {
+        std::string name(pattern);
+        size_t pos = name.find("%p");
+        if (pos != std::string::npos) name.replace(pos, 2, std::to_string(getpid()));
+
+        FILE * fp = fopen(name.c_str(), "w");
+        if (fp == NULL)
+        {
+          fprintf(stderr, "Can't open %s\n", name.c_str());
+          return;
+        }
+        double rate = tscRate();
+        bool first = true;
+
+        std::lock_guard<std::mutex> lockGuard(mutex);
+        fprintf(fp, "{\"traceEvents\":[\n");
+        for (auto & buffer : buffers)
+        {
+          buffer->events.forEach([&] (const Event & e)
+          {
+            double ts = toMicroseconds(e, e.start, rate);
+            double dur = toMicroseconds(e, e.stop, rate) - ts;
+            fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"pid\":%d,\"tid\":%u,\"args\":{\"depth\":%u",
+                    first ? "" : ",\n", e.label, ts, dur, getpid(), buffer->tid, e.depth);
+            if (e.hasCounters)
+              fprintf(fp, ",\"cycles\":%lu,\"llc_misses\":%lu,\"branch_misses\":%lu",
+                      e.counters[CYCLES], e.counters[LLC_MISSES], e.counters[BRANCH_MISSES]);
+            fprintf(fp, "}}");
+            first = false;
+          });
+        }
+        fprintf(fp, "\n]}\n");
+        fclose(fp);
+      }
+  };
+
+  inline Registry & registry()
+  {
+    static Registry r;
+    return r;
+  }
+
+  inline ThreadBuffer & localBuffer()
+  {
+    thread_local ThreadBuffer * buffer = registry().add();
+    return *buffer;
+  }
+
+  inline uint64_t steadyNow()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /*
+   * record
+   * Records an event timed by PROF_TIMERSTART and PROF_TIMERSTOP.
+   */
+  inline void record(const char * label, std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point stop)
+  {
+    ThreadBuffer & buffer = localBuffer();
+    Event e;
+    e.label = label;
+    e.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+    e.stop = std::chrono::duration_cast<std::chrono::nanoseconds>(stop.time_since_epoch()).count();
+    e.depth = buffer.depth;
+    e.clock = STEADY;
+    e.hasCounters = false;
+    buffer.events.push(e);
+  }
+
+  /*
+   * ScopedTimer
+   * Records an event covering its lifetime.
+   */
+  class ScopedTimer
+  {
+    private:
+      ThreadBuffer & buffer;
+      const char * label;
+      Clock clock;
+      bool useCounters;
+      uint64_t start;
+      uint64_t startCounters[NUMCOUNTERS];
+
+      uint64_t now() { return (clock == TSC) ? __rdtsc() : steadyNow(); }
+
+    public:
+      ScopedTimer(const char * label_, Clock clock_, bool counters)
+        : buffer(localBuffer()), label(label_), clock(clock_)
+      {
+        memset(startCounters, 0, sizeof(startCounters));
+        useCounters = counters && buffer.readCounters(startCounters);
+        buffer.depth++;
+        start = now();
+      }
+
+      ~ScopedTimer()
+      {
+        uint64_t stop = now();
+        Event e;
+        e.label = label;
+        e.start = start;
+        e.stop = stop;
+        e.depth = --buffer.depth;
+        e.clock = clock;
+        e.hasCounters = false;
+        if (useCounters && buffer.readCounters(e.counters))
+        {
+          e.hasCounters = true;
+          for (int i = 0; i < NUMCOUNTERS; i++) e.counters[i] -= startCounters[i];
+        }
+        buffer.events.push(e);
+      }
+  };
+}
+
+#endif
+#endif
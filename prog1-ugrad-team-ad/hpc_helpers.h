@@ -2,17 +2,14 @@
 #define HPC_HELPERS_H
 
 #include <iostream>
-#include <chrono>
+#include "../profiler/profiler.h"
 
 //need to provide a SPEEDUP macro to this file
 
-#define TIMERSTART(label)                                                  \
-    std::chrono::time_point<std::chrono::system_clock> a##label, b##label; \
-    a##label = std::chrono::system_clock::now();
+#define TIMERSTART(label) PROF_TIMERSTART(label)
 
 #define TIMERSTOP(label)                                                   \
-    b##label = std::chrono::system_clock::now();                           \
-    std::chrono::duration<double> delta##label = b##label-a##label;        \
+    PROF_TIMERSTOP(label)                                                  \
     std::cout << "# elapsed time ("<< #label <<"): "                       \
               << delta##label.count()  << "s" << std::endl;
 
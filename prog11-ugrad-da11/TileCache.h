@@ -0,0 +1,88 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+#define TILESIZE 64  //width and height of a tile in pixels (must be even)
+#define LEVELS 8     //number of scales between two powers of 2
+
+/*
+ * TileCache
+ * Holds the escape counts of square tiles of points of the Mandelbrot set.
+ * At scale level L the points lie on a grid with spacing spacing(L) that
+ * goes through (ORIGINX, ORIGINY): grid point (i, j) is the complex number
+ * (ORIGINX + i * spacing(L)) + (ORIGINY + j * spacing(L))i. Tile (tx, ty) of
+ * level L holds the grid points tx * TILESIZE <= i < (tx + 1) * TILESIZE and
+ * ty * TILESIZE <= j < (ty + 1) * TILESIZE, so a tile is identified by its
+ * level and its tile coordinates, and frames at the same level share tiles.
+ *
+ * spacing(L + LEVELS) is exactly spacing(L) / 2, so the points of a tile
+ * with even i and j are points of level L - LEVELS. When such a tile is
+ * cached, a new tile only computes the other three quarters of its points.
+ *
+ * When the cache holds capacity tiles, the least recently used tile is
+ * dropped. A capacity of 0 turns caching off.
+ */
+class TileCache
+{
+   private:
+      struct Key
+      {
+         int32_t level;
+         int64_t tx, ty;
+         bool operator==(const Key & k) const
+         {
+            return level == k.level && tx == k.tx && ty == k.ty;
+         }
+      };
+      struct KeyHash
+      {
+         size_t operator()(const Key & k) const
+         {
+            uint64_t h = (uint64_t) k.level * 0x9E3779B97F4A7C15ull;
+            h ^= (uint64_t) k.tx + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+            h ^= (uint64_t) k.ty + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+            return h;
+         }
+      };
+      struct Entry
+      {
+         std::vector<uint16_t> counts;
+         std::list<Key>::iterator lru;
+      };
+
+      std::unordered_map<Key, Entry, KeyHash> tiles;
+      std::list<Key> lru;               //most recently used tile first
+      std::vector<uint16_t> scratch;    //tile returned when caching is off
+      uint64_t capacity;
+      int maxIter;
+      uint64_t hits, misses, pixelsComputed, pixelsCopied;
+
+      void computeTile(const Key & key, uint16_t * counts);
+
+   public:
+      static const double ORIGINX;
+      static const double ORIGINY;
+
+      TileCache(uint64_t capacity, int maxIter);
+      const uint16_t * getTile(int32_t level, int64_t tx, int64_t ty);
+      static double spacing(int32_t level);
+      static int32_t levelFor(double pixelSpacing);
+      uint16_t escapeCount(double cx, double cy);
+      uint64_t getHits() { return hits; }
+      uint64_t getMisses() { return misses; }
+      uint64_t getPixelsComputed() { return pixelsComputed; }
+      uint64_t getPixelsCopied() { return pixelsCopied; }
+};
+
+/*
+ * floorDiv
+ * Returns a / b rounded down (toward negative infinity); b must be positive.
+ */
+inline int64_t floorDiv(int64_t a, int64_t b)
+{
+   return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+#endif
@@ -0,0 +1,40 @@
+#!/bin/bash
+#frames rendered from the tile cache must match frames computed from scratch
+tests=('-w 200 -h 200 -f 40 -z 100' '-w 320 -h 240 -f 60 -z 5000 -p bands' '-w 101 -h 77 -f 30 -m 2 -z 0.5 -x 0 -y 0')
+
+mkdir -p zoomCached zoomScratch
+for atest in "${tests[@]}"
+do
+   echo "Testing ./zoomMB $atest"
+   ./zoomMB $atest -o zoomScratch/f -k 0 > scratchOutput
+   ./zoomMB $atest -o zoomCached/f > cachedOutput
+
+   diff -r zoomScratch zoomCached > diffs
+   if [ ! -e zoomCached/f00000.jpg ] || [ -s diffs ]; then
+      echo "Test failed"
+      echo "Frames from the tile cache did not match frames computed from scratch"
+      rm -rf diffs zoomCached zoomScratch scratchOutput cachedOutput
+      exit
+   fi
+   grep "Frames per second" scratchOutput cachedOutput
+   rm -f zoomCached/* zoomScratch/*
+done
+rm -rf diffs zoomCached zoomScratch scratchOutput cachedOutput
+
+#both of the above only compare resampled frames with each other; frames
+#that line up with a grid level aren't resampled and must match escape
+#counts computed at each pixel's own position
+checks=('-w 200 -h 150 -f 1 -z 1 -c 17' '-w 120 -h 121 -f 1 -m 40 -z 40 -c 9 -k 0' '-w 64 -h 64 -f 1 -m 5000 -z 5000 -c 9 -i 500')
+for acheck in "${checks[@]}"
+do
+   echo "Testing ./zoomMB $acheck"
+   if ! ./zoomMB $acheck > checkOutput || ! grep -q " 0 pixels differ" checkOutput; then
+      echo "Test failed"
+      echo "Frames that line up with a level did not match escape counts computed directly"
+      cat checkOutput
+      rm -f checkOutput
+      exit
+   fi
+done
+rm -f checkOutput
+echo "All tests of ./zoomMB passed"
@@ -0,0 +1,60 @@
+#ifndef BATCHMULT_H
+#define BATCHMULT_H
+#include <immintrin.h>
+#include <cstdint>
+
+/*
+ * Batched multiply of many small matrices of the same shape.
+ *
+ * The matrices of a batch are stored interleaved in packs of LANES: element
+ * e (row major) of matrix b is at
+ *     (b / LANES) * rows * cols * LANES + e * LANES + b % LANES
+ * so one AVX load gets the same element of LANES matrices and each lane of
+ * the vector works on a different matrix. A batch of size matrices needs
+ * interleavedSize(rows, cols, size) floats (the last pack is padded) and
+ * must be 32 byte aligned.
+ */
+constexpr int LANES = 8;
+
+uint64_t interleavedSize(uint64_t rows, uint64_t cols, uint64_t size);
+void interleave(float * mats, float * packed, uint64_t rows, uint64_t cols, uint64_t size);
+void deinterleave(float * packed, float * mats, uint64_t rows, uint64_t cols, uint64_t size);
+void batchMult(float * A, float * B, float * C, uint64_t M, uint64_t N, uint64_t L,
+               uint64_t size, uint64_t numThreads, bool useTemplates = true);
+bool hasBatchKernel(uint64_t M, uint64_t N, uint64_t L);
+
+/*
+ * Perform the matrix multiplies A * B = C of one pack of LANES matrices.
+ * A is of size M by L,
+ * B is of size L by N,
+ * C is of size M by N
+ * M, N and L are template parameters so the column loops are unrolled
+ * (-O2 doesn't unroll them on its own). The row of C needs N of the 16 ymm
+ * registers plus two for the loads, so it stays in registers only for
+ * N up to 14; for the larger kernels it spills to the stack, which stays
+ * in L1.
+ * The products are summed in the same order as naiveMult so the results
+ * are identical.
+ * batchKernel needs to be in the header file since it is a template.
+ */
+template <int M, int N, int L>
+void batchKernel(const float * A, const float * B, float * C)
+{
+    for (int i = 0; i < M; i++)
+    {
+        __m256 row[N];
+#pragma GCC unroll 32
+        for (int j = 0; j < N; j++) row[j] = _mm256_setzero_ps();
+        for (int k = 0; k < L; k++)
+        {
+            const __m256 AV = _mm256_load_ps(A + (i*L+k)*LANES);
+#pragma GCC unroll 32
+            for (int j = 0; j < N; j++)
+                row[j] = _mm256_add_ps(row[j], _mm256_mul_ps(AV, _mm256_load_ps(B + (k*N+j)*LANES)));
+        }
+#pragma GCC unroll 32
+        for (int j = 0; j < N; j++) _mm256_store_ps(C + (i*N+j)*LANES, row[j]);
+    }
+}
+
+#endif
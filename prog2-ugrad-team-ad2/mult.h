@@ -0,0 +1,14 @@
+#ifndef MULT_H
+#define MULT_H
+#include <cstdint>
+
+void naiveMult(float * A, float * B, float * C, uint64_t M, uint64_t N, uint64_t L);
+void transposeAndMult(float * A, float * B, float * C, uint64_t M, uint64_t N, uint64_t L);
+void avxTransposeAndMult(float * A, float * B, float * C, uint64_t M, uint64_t N, uint64_t L);
+void blockedMult(float * A, float * B, float * C, uint64_t M, uint64_t N, uint64_t L, uint64_t blkSz);
+void avxBlockedMult(float * A, float * B, float * C, uint64_t M, uint64_t N, uint64_t L, uint64_t blkSz);
+void transpose(float * B, float * Bt, uint64_t rows, uint64_t cols);
+void avxBlockedMultAdd(float * A, float * Bt, float * C, uint64_t M, uint64_t N, uint64_t L,
+                       uint64_t blkSz);
+
+#endif
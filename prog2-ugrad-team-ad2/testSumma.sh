@@ -0,0 +1,33 @@
+#!/bin/bash
+# Checks ./summa against naiveMult on several process grids and then reports
+# the strong scaling efficiency of a larger multiply: T(1) / (p * T(p)).
+tests=('-m 256 -n 256 -l 256' '-m 512 -n 512 -l 768 -b 64' '-m 200 -n 384 -l 384')
+procs=(1 2 4 8)
+big='-m 2048 -n 2048 -l 2048 -b 64'
+
+
+for atest in "${tests[@]}"
+do
+   for np in "${procs[@]}"
+   do
+      echo "Testing mpirun -np $np ./summa $atest -c"
+      mpirun -np $np ./summa $atest -c > summaOutput
+      if ! grep -q "matches naiveMult" summaOutput; then
+         echo "Test failed"
+         cat summaOutput
+         rm -f summaOutput
+         exit
+      fi
+   done
+done
+echo "All tests of ./summa passed"
+
+for np in "${procs[@]}"
+do
+   mpirun -np $np ./summa $big > summaOutput
+   time=$(grep "SUMMA time:" summaOutput | awk '{print $3}')
+   if [ $np -eq 1 ]; then base=$time; fi
+   awk -v np=$np -v t=$time -v base=$base \
+       'BEGIN { printf("%d processes: %f seconds, scaling efficiency %.3f\n", np, t, base / (np * t)) }'
+done
+rm -f summaOutput
@@ -0,0 +1,252 @@
+#ifndef DISTRIBUTEDSCAN_H
+#define DISTRIBUTEDSCAN_H
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <type_traits>
+#include "mpi.h"
+#include "helpers.h"
+#include "ThreadPool.h"
+#include "../placement/placement.h"
+
+/*
+ * DistributedScan
+ * Performs an inclusive prefix scan of an array that is distributed across
+ * the MPI processes. Each process holds a shard of the array, and the
+ * shard of process p comes after the shard of process p - 1. T is the
+ * element type and Op is an associative binary operator on T (it doesn't
+ * need to be commutative or have an identity).
+ *
+ * The whole class is in the header file since it is a template.
+ */
+template <typename T, typename Op = std::plus<T>>
+class DistributedScan
+{
+  //the values (and Prefix) are sent between the processes as raw bytes
+  static_assert(std::is_trivially_copyable<T>::value,
+                "DistributedScan needs a trivially copyable element type");
+
+  private:
+    //value that may be empty; the prefix before the first element is empty
+    struct Prefix
+    {
+      T value;
+      bool valid;
+    };
+
+    std::vector<T> nums;
+    uint64_t numThreads;
+    bool useTree;
+    ThreadPool * pool;
+    Op op;
+    double computeTime, commTime, fixupTime;
+
+    /*
+     * combine
+     * Returns the prefix a followed by the prefix b.
+     */
+    Prefix combine(Prefix a, Prefix b)
+    {
+      if (!a.valid) return b;
+      if (!b.valid) return a;
+      return Prefix{op(a.value, b.value), true};
+    }
+
+    /*
+     * reduceFunc
+     * Used by MPI to combine the values of two processes; invec holds the
+     * values of the lower ranked processes.
+     */
+    static void reduceFunc(const void * invec, void * inoutvec, int len,
+                           const MPI::Datatype & datatype)
+    {
+      const T * in = (const T *) invec;
+      T * inout = (T *) inoutvec;
+      Op op;
+      for (int i = 0; i < len; i++) inout[i] = op(in[i], inout[i]);
+    }
+
+    /*
+     * exscanOffset
+     * Uses MPI's Exscan to compute the combination of the totals of the
+     * processes before this one. Process 0 gets an empty prefix.
+     */
+    Prefix exscanOffset(T total)
+    {
+      MPI::Datatype type = MPI::BYTE.Create_contiguous(sizeof(T));
+      type.Commit();
+      MPI::Op mpiOp;
+      mpiOp.Init(reduceFunc, false);
+
+      Prefix offset;
+      MPI::COMM_WORLD.Exscan(&total, &offset.value, 1, type, mpiOp);
+      offset.valid = (MPI::COMM_WORLD.Get_rank() != 0);
+
+      mpiOp.Free();
+      type.Free();
+      return offset;
+    }
+
+    /*
+     * treeOffset
+     * Computes the same offset as exscanOffset with an up-sweep and a
+     * down-sweep over a binary tree of the processes. At level d the
+     * processes are grouped into segments of 2d ranks; the last rank in
+     * each half of a segment owns that half. In the up-sweep the owner of
+     * the left half sends its sum to the owner of the right half. In the
+     * down-sweep the owner of the segment sends the prefix of the segment to
+     * the owner of the left half and combines it with the left half's sum
+     * to get the prefix of the right half. Each process sends and receives
+     * at most 2 log(numP) messages, and none of them go through process 0,
+     * which helps when there are many processes.
+     */
+    Prefix treeOffset(T total)
+    {
+      int myId = MPI::COMM_WORLD.Get_rank();
+      int numP = MPI::COMM_WORLD.Get_size();
+      int top = 1;
+      while (top < numP) top *= 2;
+
+      //owner of the half of the segment starting at s of size d
+      auto owner = [&] (int s, int d) { return std::min(s + d - 1, numP - 1); };
+
+      //sums of the left halves received in the up-sweep, by level
+      std::vector<Prefix> leftSums;
+      Prefix sum{total, true};
+      for (int d = 1; d < top; d *= 2)
+      {
+        int s = (myId / (2 * d)) * (2 * d);
+        Prefix left{T(), false};
+        if (s + d < numP)
+        {
+          if (myId == owner(s, d))
+            MPI::COMM_WORLD.Send(&sum, sizeof(Prefix), MPI::BYTE, owner(s + d, d), d);
+          else if (myId == owner(s + d, d))
+          {
+            MPI::COMM_WORLD.Recv(&left, sizeof(Prefix), MPI::BYTE, owner(s, d), d);
+            sum = combine(left, sum);
+          }
+        }
+        leftSums.push_back(left);
+      }
+
+      Prefix offset{T(), false};
+      int level = leftSums.size() - 1;
+      for (int d = top / 2; d >= 1; d /= 2, level--)
+      {
+        int s = (myId / (2 * d)) * (2 * d);
+        if (s + d < numP)
+        {
+          if (myId == owner(s + d, d))
+          {
+            MPI::COMM_WORLD.Send(&offset, sizeof(Prefix), MPI::BYTE, owner(s, d), d);
+            offset = combine(offset, leftSums[level]);
+          }
+          else if (myId == owner(s, d))
+            MPI::COMM_WORLD.Recv(&offset, sizeof(Prefix), MPI::BYTE, owner(s + d, d), d);
+        }
+      }
+      return offset;
+    }
+
+  public:
+    /*
+     * DistributedScan
+     * Takes this process's shard of the array (which can't be empty), the
+     * number of threads used to scan it, and whether the offsets of the
+     * processes are computed with MPI's Exscan or with treeOffset.
+     * The pages of chunk i of the shard are moved to the node of pool
+     * worker i.
+     */
+    DistributedScan(std::vector<T> nums, uint64_t numThreads, bool useTree = false)
+    {
+      //Use std::move to prevent another copy of nums being made.
+      this->nums = std::move(nums);
+      this->numThreads = numThreads;
+      this->useTree = useTree;
+      this->pool = new ThreadPool(numThreads);
+      place::distribute(this->nums.data(), this->nums.size(), numThreads);
+      computeTime = commTime = fixupTime = 0;
+    }
+
+    ~DistributedScan()
+    {
+      delete pool;
+    }
+
+    /*
+     * performScan
+     * The shard is split into numThreads chunks.
+     * Step 1: each chunk is scanned by a ThreadPool task.
+     * Step 2: the main thread scans the chunk totals to get the prefix of
+     *         each chunk and the total of the shard.
+     * Step 3: the processes combine their totals to get the prefix of
+     *         each shard.
+     * Step 4: each task adds the shard prefix and the chunk prefix to every
+     *         element of its chunk. The two are combined first so the
+     *         elements are only visited once.
+     * Any worker of the pool can pick up the task for chunk i, so the
+     * chunks are only spread over the nodes of the workers; the tasks
+     * don't rebind the workers the pool pinned.
+     * Returns the time of the scan on this process.
+     */
+    double performScan()
+    {
+      uint64_t size = nums.size();
+      auto chunkStart = [&] (uint64_t id) { return (size * id) / numThreads; };
+      std::vector<Prefix> chunkPrefix(numThreads);
+
+      TIMERSTART(compute)
+      auto scanChunk = [&] (uint64_t id)
+      {
+        for (uint64_t j = chunkStart(id) + 1; j < chunkStart(id + 1); j++)
+          nums[j] = op(nums[j - 1], nums[j]);
+      };
+      for (uint64_t i = 0; i < numThreads; i++) pool->enqueue(scanChunk, i);
+      pool->waitForZeroTasks();
+
+      Prefix total{T(), false};
+      for (uint64_t i = 0; i < numThreads; i++)
+      {
+        chunkPrefix[i] = total;
+        if (chunkStart(i) < chunkStart(i + 1))
+          total = combine(total, Prefix{nums[chunkStart(i + 1) - 1], true});
+      }
+      TIMERSTOP(compute)
+
+      TIMERSTART(comm)
+      Prefix offset = useTree ? treeOffset(total.value) : exscanOffset(total.value);
+      TIMERSTOP(comm)
+
+      TIMERSTART(fixup)
+      auto fixChunk = [&] (uint64_t id)
+      {
+        Prefix prefix = combine(offset, chunkPrefix[id]);
+        if (!prefix.valid) return;
+        for (uint64_t j = chunkStart(id); j < chunkStart(id + 1); j++)
+          nums[j] = op(prefix.value, nums[j]);
+      };
+      for (uint64_t i = 0; i < numThreads; i++) pool->enqueue(fixChunk, i);
+      pool->waitForZeroTasks();
+      TIMERSTOP(fixup)
+
+      computeTime = GETTIME(compute);
+      commTime = GETTIME(comm);
+      fixupTime = GETTIME(fixup);
+      return computeTime + commTime + fixupTime;
+    }
+
+    /*
+     * get
+     * Returns a reference to the scanned shard.
+     */
+    std::vector<T> & get()
+    {
+      return nums;
+    }
+
+    double getComputeTime() { return computeTime; }
+    double getCommTime() { return commTime; }
+    double getFixupTime() { return fixupTime; }
+};
+#endif
@@ -1,6 +1,9 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 #include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <memory>
 #include <future>
 #include <vector>
 #include <queue>
@@ -3,6 +3,9 @@
 
 #include <stdio.h>
 #include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <memory>
 #include <future>
 #include <vector>
 #include <queue>
@@ -3,15 +3,12 @@
 
 #include <iostream>
 #include <cstdint>
+#include "../profiler/profiler.h"
 
-#define TIMERSTART(label)                                                  \
-   std::chrono::time_point<std::chrono::system_clock> a##label, b##label; \
-   a##label = std::chrono::system_clock::now();
+#define TIMERSTART(label) PROF_TIMERSTART(label)
 
-#define TIMERSTOP(label)                                                   \
-    b##label = std::chrono::system_clock::now();                           \
-    std::chrono::duration<double> delta##label = b##label-a##label;        
+#define TIMERSTOP(label) PROF_TIMERSTOP(label)
 
-#define GETTIME(label) delta##label.count()
+#define GETTIME(label) PROF_GETTIME(label)
 
 #endif
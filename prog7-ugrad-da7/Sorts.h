@@ -9,10 +9,11 @@ class Sorts
     uint64_t size;
     std::string description;
   public:
-    Sorts(uint64_t size, int32_t * input);
+    Sorts(uint64_t size, int32_t * input, int32_t threadCt = 1);
     bool match(Sorts * sptr);
     bool increasing();
     std::string getDescription();
+    int32_t * getData();
     virtual double sort() = 0;
     virtual ~Sorts();
 };